@@ -2,7 +2,6 @@
 #define XBEE_AT_COMMANDS_H
 
 #include "Arduino.h"
-#include <avr/pgmspace.h>
 
 /**
 
@@ -92,6 +91,7 @@ Table of AT commands supported by different XBee devices:
     ATVR     |        +         |       CRE        | Firmware version
     ATHV     |        +         |       CRE        | Hardware version
     ATAI     |        +         |       CRE        | Association Indication
+    ATDB     |        +         |       CRE        | RSSI of the last received packet
     ATAS     |        +         |                  | WiFi: active scan
     ATTP     |        +         |                  | S6: read temperature (degrees Celsius)
     ATCK     |        +         |                  | S6: configuration code
@@ -124,17 +124,17 @@ Table of AT commands supported by different XBee devices:
 #define XBEE_AT_PREFIX_LENGTH 2
 #define XBEE_AT_COMMAND_LENGTH 2
  
-typedef prog_char XBeeATPrefix[XBEE_AT_PREFIX_LENGTH];
-typedef prog_char XBeeAT[XBEE_AT_COMMAND_LENGTH];
+typedef char XBeeATPrefix[XBEE_AT_PREFIX_LENGTH];
+typedef char XBeeAT[XBEE_AT_COMMAND_LENGTH];
  
 const XBeeATPrefix XBEE_AT_PREFIX = { 'A', 'T' };
 
-void copyCommand(XBeeAT* command, char* destination)
+inline void copyCommand(XBeeAT* command, char* destination)
 {
 
 }
 
-void writeFullCommand(XBeeAT* command, Stream* stream)
+inline void writeFullCommand(XBeeAT* command, Stream* stream)
 {
 
 }
@@ -328,6 +328,7 @@ const XBeeAT XBEE_ATCH = { 'C', 'H' };
 #define XBEE_ATVR 0x5652 // Firmware version
 #define XBEE_ATHV 0x4856 // Hardware version
 #define XBEE_ATAI 0x4149 // Association indication (XBEE_ATAI_*, read-only)
+#define XBEE_ATDB 0x4442 // RSSI of the last received packet, -dBm (read-only)
 #define XBEE_ATAS 0x4153 // Active scan (may only be issued after ATNR)
 #define XBEE_ATTP 0x5450 // Module temperature
 #define XBEE_ATCK 0x434B // Configuration code
@@ -15,7 +15,15 @@
 class XBeeS2 : public XBeeBase
 {
 	public:
-		
+		/**
+		 * Constructor.
+		 *
+		 * @param controlPort Pointer to the stream used to control target XBee module
+		 * (see XBeeBase::XBeeBase() for details).
+		 */
+		XBeeS2(Stream* controlPort) : XBeeBase(controlPort)
+		{
+		}
 };
 
 #endif
\ No newline at end of file
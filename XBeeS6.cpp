@@ -6,16 +6,23 @@ uint64_t XBeeS6::getIP(byte octet0, byte octet1, byte octet2, byte octet3)
 	return result;
 }
 
-void XBeeS6::sendTx64Request(uint64_t ip, boolean disableACK, int length, byte* data)
+byte XBeeS6::sendTx64Request(uint64_t ip, boolean disableACK, int length, byte* data)
 {
+	byte frameId = nextFrameId();
+
 	writeHeader(length + XBEE_API_TX64_REQUEST_HEADER_LENGTH);
 	
-	writeByte(XBEE_API_TX64_REQUEST);
-	writeEscapedByte(XBEE_DUMMY_FRAME_ID); // frame ID
+	writeDataByte(XBEE_API_TX64_REQUEST);
+	writeDataByte(frameId);
 	writeDataInt64(ip);
 	
 	byte txOptions = disableACK ? XBEE_API_TX64_REQUEST_DISABLE_ACK_MASK : 0x00;
-	writeByte(txOptions);
+	writeDataByte(txOptions);
 	
 	writeData(length, data);
+
+	if (!writeChecksum())
+		return XBEE_DUMMY_FRAME_ID;
+
+	return frameId;
 }
\ No newline at end of file
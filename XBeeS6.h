@@ -18,6 +18,16 @@
 class XBeeS6 : public XBeeBase
 {
 	public:
+		/**
+		 * Constructor.
+		 *
+		 * @param controlPort Pointer to the stream used to control target XBee module
+		 * (see XBeeBase::XBeeBase() for details).
+		 */
+		XBeeS6(Stream* controlPort) : XBeeBase(controlPort)
+		{
+		}
+
 		/**
 		 * Converts the human-readable IPv4 address (like 192.168.10.25) to the 64-bit form
 		 * acceptable by XBee S6 (like 0x00000000C0A80A19). Can be used to form IP address
@@ -41,8 +51,12 @@ class XBeeS6 : public XBeeBase
 		 * the acknowledgement for this request or not.
 		 * @param length Length of buffer containing data.
 		 * @param data Byte buffer containing data to send.
+		 *
+		 * @return Frame ID of sent frame. Delivery status is reported with TX status frame
+		 * having the same frame ID. XBEE_DUMMY_FRAME_ID is returned if the frame was dropped
+		 * by the sleep scheduler - it will never be sent.
 		 */
-		void sendTx64Request(uint64_t ip, boolean disableACK, int length, byte* data);
+		byte sendTx64Request(uint64_t ip, boolean disableACK, int length, byte* data);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <XBeeATCommands.h>
+#include <XBeeS6.h>
+
+/**
+ * Checks XBeeLinkAdapter end-to-end against a simulated XBee S6 module (IBSS creator, AP = 1).
+ * The simulated module parses API frames sent by XBeeS6, loses TX64 requests with probability
+ * depending on current bit rate, power level and path loss, and replies with TX status frames
+ * and AT command responses. ATDB reports the signal of the peer, which does not depend on our
+ * power level.
+ *
+ * Every scenario runs the adapter for a while, then measures delivery rate and goodput (average
+ * speed of delivered frames per sent frame) and compares them with the floors of the scenario.
+ * It also limits how often the settings change, so the adapter must not keep flapping between
+ * neighbour settings.
+ * Results are printed to Serial; the sketch exits with non-zero code if any check fails.
+ */
+
+#define SIM_PEER_POWER 13 // dBm
+#define SIM_FADING     3  // dB, maximum random deviation of received signal
+
+#define SIM_WARMUP_FRAMES   1000
+#define SIM_MEASURED_FRAMES 2000
+
+// ATBR and ATPL changes allowed while measuring (100 windows of 20 frames).
+#define SIM_MAX_SETTING_CHANGES 15
+
+#define SIM_RX_BUFFER_SIZE  32
+#define SIM_TX_BUFFER_SIZE  64
+
+#define SIM_AT_COMMAND_STATUS_ERROR 0x01
+
+// Receiver sensitivity (dBm) and nominal speed (x0.1 Mbps), indexed by ATBR value.
+const int SIM_SENSITIVITY[] = { 0, -93, -91, -89, -86, -88, -87, -85, -83, -80, -76, -72, -70 };
+const int SIM_SPEED[]       = { 0,  10,  20,  55, 110,  60,  90, 120, 180, 240, 360, 480, 540 };
+
+// Output power (dBm), indexed by ATPL value.
+const int SIM_POWER[] = { 0, 5, 10, 13, 16 };
+
+struct SimScenario
+{
+	const char* name;
+	int pathLoss;            // dB, both directions
+	int uplinkPenalty;       // dB, extra loss (i.e. interference at the peer) only for our frames
+	boolean rejectBitRate;   // module is not IBSS creator and rejects ATBR
+	byte initialBitRate;     // bit rate of the module before the adapter starts
+	int minDeliveryPercent;
+	int minGoodput;          // x0.1 Mbps
+	byte minPowerLevel;      // range of power levels expected at the end of the scenario
+	byte maxPowerLevel;
+};
+
+const SimScenario SIM_SCENARIOS[] =
+{
+	{ "moderate link",          92,  0, false, XBEE_ATBR_1MBPS,  85, 150, XBEE_ATPL_HIGHEST, XBEE_ATPL_HIGHEST },
+	{ "strong link",            60,  0, false, XBEE_ATBR_1MBPS,  85, 500, XBEE_ATPL_LOWEST,  XBEE_ATPL_MEDIUM },
+	{ "asymmetric link",        60, 17, false, XBEE_ATBR_1MBPS,  85, 450, XBEE_ATPL_MEDIUM,  XBEE_ATPL_HIGHEST },
+	{ "bit rate not settable",  60,  0, true,  XBEE_ATBR_11MBPS, 85, 100, XBEE_ATPL_LOWEST,  XBEE_ATPL_LOW },
+};
+
+#define SIM_SCENARIO_COUNT (sizeof(SIM_SCENARIOS) / sizeof(SIM_SCENARIOS[0]))
+
+class SimulatedModule : public Stream
+{
+	public:
+		const SimScenario* scenario;
+		byte bitRate;
+		byte powerLevel;
+		byte lastRssi;
+		long sentFrames;
+		long deliveredFrames;
+		long deliveredSpeed;
+		int settingChanges;
+
+		SimulatedModule()
+		{
+			_rxState = 0;
+			_txHead = 0;
+			_txTail = 0;
+		}
+
+		void reset(const SimScenario* newScenario)
+		{
+			scenario = newScenario;
+			bitRate = scenario -> initialBitRate;
+			powerLevel = XBEE_ATPL_HIGHEST;
+			lastRssi = 0;
+			resetCounters();
+		}
+
+		void resetCounters()
+		{
+			sentFrames = 0;
+			deliveredFrames = 0;
+			deliveredSpeed = 0;
+			settingChanges = 0;
+		}
+
+		virtual size_t write(uint8_t data)
+		{
+			switch (_rxState)
+			{
+				case 0:
+					if (data == XBEE_FRAME_DELIMITER)
+						_rxState = 1;
+					break;
+
+				case 1:
+					_rxLength = data << 8;
+					_rxState = 2;
+					break;
+
+				case 2:
+					_rxLength |= data;
+					_rxPosition = 0;
+					_rxState = (_rxLength > 0 && _rxLength <= SIM_RX_BUFFER_SIZE) ? 3 : 0;
+					break;
+
+				case 3:
+					_rxFrame[_rxPosition++] = data;
+					if (_rxPosition == _rxLength)
+						_rxState = 4;
+					break;
+
+				case 4:
+					// Checksum is not verified - frames come directly from the library.
+					processFrame();
+					_rxState = 0;
+					break;
+			}
+
+			return 1;
+		}
+
+		virtual int available()
+		{
+			return (_txHead - _txTail + SIM_TX_BUFFER_SIZE) % SIM_TX_BUFFER_SIZE;
+		}
+
+		virtual int read()
+		{
+			if (_txHead == _txTail)
+				return -1;
+
+			byte data = _txBuffer[_txTail];
+			_txTail = (_txTail + 1) % SIM_TX_BUFFER_SIZE;
+			return data;
+		}
+
+		virtual int peek()
+		{
+			return (_txHead == _txTail) ? -1 : _txBuffer[_txTail];
+		}
+
+		virtual void flush()
+		{
+		}
+
+	private:
+		byte _rxFrame[SIM_RX_BUFFER_SIZE];
+		byte _rxState;
+		int _rxLength;
+		int _rxPosition;
+
+		byte _txBuffer[SIM_TX_BUFFER_SIZE];
+		int _txHead;
+		int _txTail;
+
+		int fading()
+		{
+			return random(-SIM_FADING, SIM_FADING + 1);
+		}
+
+		void processFrame()
+		{
+			byte frameId = _rxFrame[1];
+
+			if (_rxFrame[0] == XBEE_API_TX64_REQUEST)
+			{
+				// Our frame at the peer depends on our power, the reply of the peer does not.
+				int received = SIM_POWER[powerLevel] - scenario -> pathLoss - scenario -> uplinkPenalty + fading();
+				int margin = received - SIM_SENSITIVITY[bitRate];
+				int deliveryPercent = constrain(50 + margin * 15, 0, 99);
+
+				lastRssi = -(SIM_PEER_POWER - scenario -> pathLoss + fading());
+
+				byte response[] = { XBEE_API_TX_STATUS, frameId, XBEE_TX_STATUS_SUCCESS };
+				sentFrames++;
+
+				if (random(100) < deliveryPercent)
+				{
+					deliveredFrames++;
+					deliveredSpeed += SIM_SPEED[bitRate];
+				}
+				else
+				{
+					response[2] = 0x01; // no ACK received
+				}
+
+				reply(sizeof(response), response);
+			}
+			else if (_rxFrame[0] == XBEE_API_AT_COMMAND)
+			{
+				byte response[] = { XBEE_API_AT_COMMAND_RESPONSE, frameId, _rxFrame[2], _rxFrame[3], XBEE_AT_COMMAND_STATUS_OK, 0 };
+				int command = (_rxFrame[2] << 8) | _rxFrame[3];
+				int length = sizeof(response) - 1;
+
+				if (command == XBEE_ATBR && _rxLength > 4)
+				{
+					if (scenario -> rejectBitRate)
+						response[4] = SIM_AT_COMMAND_STATUS_ERROR;
+					else
+						setBitRate(_rxFrame[4]);
+				}
+				else if (command == XBEE_ATPL && _rxLength > 4)
+					setPowerLevel(_rxFrame[4]);
+				else if (command == XBEE_ATBR)
+					response[length++] = bitRate;
+				else if (command == XBEE_ATPL)
+					response[length++] = powerLevel;
+				else if (command == XBEE_ATDB)
+					response[length++] = lastRssi;
+
+				reply(length, response);
+			}
+		}
+
+		void setBitRate(byte value)
+		{
+			if (value != bitRate)
+				settingChanges++;
+
+			bitRate = value;
+		}
+
+		void setPowerLevel(byte value)
+		{
+			if (value != powerLevel)
+				settingChanges++;
+
+			powerLevel = value;
+		}
+
+		void reply(int length, byte* frame)
+		{
+			byte checksum = 0xFF;
+
+			putByte(XBEE_FRAME_DELIMITER);
+			putByte(length >> 8);
+			putByte(length & 0xFF);
+
+			for (int i = 0; i < length; i++)
+			{
+				putByte(frame[i]);
+				checksum -= frame[i];
+			}
+
+			putByte(checksum);
+		}
+
+		void putByte(byte data)
+		{
+			_txBuffer[_txHead] = data;
+			_txHead = (_txHead + 1) % SIM_TX_BUFFER_SIZE;
+		}
+};
+
+SimulatedModule module;
+XBeeS6 xbee(&module);
+XBeeLinkAdapter adapter(&xbee);
+
+byte payload[] = { 'p', 'i', 'n', 'g' };
+
+int failures = 0;
+
+void check(boolean condition, const char* description)
+{
+	Serial.print(condition ? "  ok:     " : "  FAILED: ");
+	Serial.println(description);
+
+	if (!condition)
+		failures++;
+}
+
+void sendFrames(long count)
+{
+	for (long i = 0; i < count; i++)
+	{
+		xbee.sendTx64Request(XBeeS6::getIP(192, 168, 1, 2), false, sizeof(payload), payload);
+		xbee.readData();
+	}
+}
+
+void runScenario(const SimScenario* scenario)
+{
+	module.reset(scenario);
+
+	adapter = XBeeLinkAdapter(&xbee);
+	adapter.setTargetDeliveryRate(90, 5);
+	adapter.setBitRateRange(XBEE_ATBR_1MBPS, XBEE_ATBR_54MBPS);
+	xbee.setLinkAdapter(&adapter);
+
+	adapter.begin();
+	xbee.readData();
+
+	sendFrames(SIM_WARMUP_FRAMES);
+	module.resetCounters();
+	sendFrames(SIM_MEASURED_FRAMES);
+
+	int deliveryPercent = module.deliveredFrames * 100 / module.sentFrames;
+	int goodput = module.deliveredSpeed / module.sentFrames;
+
+	Serial.print(scenario -> name);
+	Serial.print(": rate x0.1 Mbps: ");
+	Serial.print(SIM_SPEED[module.bitRate]);
+	Serial.print(", power level: ");
+	Serial.print(module.powerLevel);
+	Serial.print(", delivered: ");
+	Serial.print(deliveryPercent);
+	Serial.print("%, goodput x0.1 Mbps: ");
+	Serial.print(goodput);
+	Serial.print(", setting changes: ");
+	Serial.println(module.settingChanges);
+
+	check(deliveryPercent >= scenario -> minDeliveryPercent, "delivery rate above the floor");
+	check(goodput >= scenario -> minGoodput, "goodput above the floor");
+	check(module.settingChanges <= SIM_MAX_SETTING_CHANGES, "settings do not flap");
+	check(module.powerLevel >= scenario -> minPowerLevel && module.powerLevel <= scenario -> maxPowerLevel,
+			"power level within the expected range");
+	check(adapter.getBitRate() == module.bitRate && adapter.getPowerLevel() == module.powerLevel,
+			"adapter is in sync with the module");
+}
+
+void setup()
+{
+	Serial.begin(9600);
+	randomSeed(1);
+
+	for (byte i = 0; i < SIM_SCENARIO_COUNT; i++)
+		runScenario(&SIM_SCENARIOS[i]);
+
+	Serial.println(failures == 0 ? "PASSED" : "FAILED");
+	Serial.flush();
+
+	exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,233 @@
+#include <XBeeS6.h>
+
+/**
+ * Checks XBeeSleepScheduler against a simulated XBee S6 module: frames sent while the module
+ * sleeps must be queued, a frame not fitting into the queue must be dropped and reported, and
+ * queued frames must reach the module as one burst after it wakes up. ON_SLEEP pin changes are
+ * simulated with XBeeSleepScheduler::setAwake(), as an interrupt handler would do. Then the same
+ * is checked with modem status frames parsed by XBeeBase::readData(), including a corrupted one
+ * that must be ignored.
+ *
+ * Results are printed to Serial; the sketch exits with non-zero code if any check fails.
+ */
+
+#define SIM_QUEUE_SIZE 128
+#define SIM_TX_BUFFER_SIZE 32
+
+class SimulatedModule : public Stream
+{
+	public:
+		boolean awake;
+		int receivedFrames;
+		int lostFrames;
+		int bursts;
+
+		SimulatedModule()
+		{
+			awake = true;
+			receivedFrames = 0;
+			lostFrames = 0;
+			bursts = 0;
+			_rxState = 0;
+			_txHead = 0;
+			_txTail = 0;
+		}
+
+		/**
+		 * Sends modem status frame to the host.
+		 */
+		void sendModemStatus(byte status, boolean corruptChecksum)
+		{
+			byte checksum = 0xFF - XBEE_API_MODEM_STATUS - status;
+
+			putByte(XBEE_FRAME_DELIMITER);
+			putByte(0x00);
+			putByte(0x02);
+			putByte(XBEE_API_MODEM_STATUS);
+			putByte(status);
+			putByte(corruptChecksum ? checksum + 1 : checksum);
+		}
+
+		virtual size_t write(uint8_t data)
+		{
+			switch (_rxState)
+			{
+				case 0:
+					if (data == XBEE_FRAME_DELIMITER)
+						_rxState = 1;
+					break;
+
+				case 1:
+					_rxRemaining = data << 8;
+					_rxState = 2;
+					break;
+
+				case 2:
+					// Frame data and checksum follow.
+					_rxRemaining = (_rxRemaining | data) + 1;
+					_rxState = 3;
+					break;
+
+				case 3:
+					if (--_rxRemaining == 0)
+					{
+						// Frames arriving into the sleeping module are lost.
+						if (awake)
+							receivedFrames++;
+						else
+							lostFrames++;
+
+						_rxState = 0;
+					}
+					break;
+			}
+
+			return 1;
+		}
+
+		virtual size_t write(const uint8_t* buffer, size_t size)
+		{
+			bursts++;
+
+			for (size_t i = 0; i < size; i++)
+				write(buffer[i]);
+
+			return size;
+		}
+
+		virtual int available()
+		{
+			return (_txHead - _txTail + SIM_TX_BUFFER_SIZE) % SIM_TX_BUFFER_SIZE;
+		}
+
+		virtual int read()
+		{
+			if (_txHead == _txTail)
+				return -1;
+
+			byte data = _txBuffer[_txTail];
+			_txTail = (_txTail + 1) % SIM_TX_BUFFER_SIZE;
+			return data;
+		}
+
+		virtual int peek()
+		{
+			return (_txHead == _txTail) ? -1 : _txBuffer[_txTail];
+		}
+
+		virtual void flush()
+		{
+		}
+
+	private:
+		byte _rxState;
+		int _rxRemaining;
+
+		byte _txBuffer[SIM_TX_BUFFER_SIZE];
+		int _txHead;
+		int _txTail;
+
+		void putByte(byte data)
+		{
+			_txBuffer[_txHead] = data;
+			_txHead = (_txHead + 1) % SIM_TX_BUFFER_SIZE;
+		}
+};
+
+SimulatedModule module;
+XBeeS6 xbee(&module);
+
+byte queue[SIM_QUEUE_SIZE];
+XBeeSleepScheduler scheduler(&module, queue, sizeof(queue));
+
+byte smallPayload[20];
+byte largePayload[SIM_QUEUE_SIZE];
+
+int failures = 0;
+
+void check(boolean condition, const char* description)
+{
+	Serial.print(condition ? "ok:     " : "FAILED: ");
+	Serial.println(description);
+
+	if (!condition)
+		failures++;
+}
+
+void setModuleAwake(boolean awake)
+{
+	module.awake = awake;
+	scheduler.setAwake(awake);
+}
+
+byte send(int length, byte* data)
+{
+	return xbee.sendTx64Request(XBeeS6::getIP(192, 168, 1, 2), true, length, data);
+}
+
+void setup()
+{
+	Serial.begin(9600);
+
+	xbee.setSleepScheduler(&scheduler);
+
+	check(send(sizeof(smallPayload), smallPayload) != XBEE_DUMMY_FRAME_ID, "frame sent while awake");
+	check(module.receivedFrames == 1, "frame reached awake module");
+
+	setModuleAwake(false);
+
+	boolean allQueued = true;
+	for (int i = 0; i < 3; i++)
+		allQueued &= (send(sizeof(smallPayload), smallPayload) != XBEE_DUMMY_FRAME_ID);
+
+	check(allQueued, "frames accepted while asleep");
+	check(module.receivedFrames == 1 && module.lostFrames == 0, "nothing sent to sleeping module");
+	check(scheduler.getQueuedFrames() == 3, "frames queued while asleep");
+
+	check(send(sizeof(largePayload), largePayload) == XBEE_DUMMY_FRAME_ID, "frame larger than queue reported as dropped");
+	check(scheduler.getDroppedFrames() == 1, "dropped frame counted");
+	check(scheduler.getQueuedFrames() == 3, "dropped frame does not corrupt queue");
+
+	int burstsBeforeWakeUp = module.bursts;
+
+	setModuleAwake(true);
+	xbee.readData();
+
+	check(module.receivedFrames == 4, "queued frames reached module after wake-up");
+	check(module.bursts - burstsBeforeWakeUp == 1, "queued frames sent as one burst");
+	check(scheduler.getQueuedFrames() == 0 && scheduler.getQueuedBytes() == 0, "queue empty after flush");
+	check(module.lostFrames == 0, "no frames lost");
+
+	// Sleep state from modem status frames (as DigiMesh modules report it).
+	module.sendModemStatus(XBEE_MODEM_STATUS_NETWORK_WENT_TO_SLEEP, true);
+	xbee.readData();
+	check(scheduler.isAwake(), "modem status with bad checksum ignored");
+
+	module.awake = false;
+	module.sendModemStatus(XBEE_MODEM_STATUS_NETWORK_WENT_TO_SLEEP, false);
+	xbee.readData();
+	check(!scheduler.isAwake(), "sleep detected from modem status");
+
+	for (int i = 0; i < 2; i++)
+		send(sizeof(smallPayload), smallPayload);
+
+	check(module.receivedFrames == 4 && scheduler.getQueuedFrames() == 2, "frames queued after modem status");
+
+	// Module reset wakes it up.
+	module.awake = true;
+	module.sendModemStatus(XBEE_MODEM_STATUS_HARDWARE_RESET, false);
+	xbee.readData();
+
+	check(scheduler.isAwake(), "wake-up detected from hardware reset status");
+	check(module.receivedFrames == 6 && scheduler.getQueuedFrames() == 0, "queue flushed after hardware reset status");
+	check(module.lostFrames == 0, "no frames lost after modem status");
+
+	Serial.println(failures == 0 ? "PASSED" : "FAILED");
+	Serial.flush();
+
+	exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -3,12 +3,148 @@
 XBeeBase::XBeeBase(Stream* controlPort)
 {
 	_controlPort = controlPort;
+	_sleepScheduler = NULL;
+	_linkAdapter = NULL;
+	_frameId = XBEE_DUMMY_FRAME_ID;
 	_escapementRequired = false;
+	_rxState = XBEE_RX_STATE_WAITING_FOR_DELIMITER;
+	_rxUnescapeNext = false;
+	_rxLength = 0;
+	_rxPosition = 0;
+	_rxChecksum = 0xFF;
+}
+
+void XBeeBase::readData()
+{
+	while (_controlPort -> available() > 0)
+	{
+		byte data = _controlPort -> read();
+
+		if (_rxState == XBEE_RX_STATE_WAITING_FOR_DELIMITER)
+		{
+			if (data == XBEE_FRAME_DELIMITER)
+				_rxState = XBEE_RX_STATE_LENGTH_HIGH;
+
+			continue;
+		}
+
+		if (_escapementRequired)
+		{
+			// With escapement enabled, unescaped delimiter always starts the new frame.
+			if (data == XBEE_FRAME_DELIMITER)
+			{
+				_rxState = XBEE_RX_STATE_LENGTH_HIGH;
+				_rxUnescapeNext = false;
+				continue;
+			}
+
+			if (data == XBEE_ESCAPE)
+			{
+				_rxUnescapeNext = true;
+				continue;
+			}
+
+			if (_rxUnescapeNext)
+			{
+				data ^= XBEE_UNESCAPE;
+				_rxUnescapeNext = false;
+			}
+		}
+
+		switch (_rxState)
+		{
+			case XBEE_RX_STATE_LENGTH_HIGH:
+				_rxLength = data << 8;
+				_rxState = XBEE_RX_STATE_LENGTH_LOW;
+				break;
+
+			case XBEE_RX_STATE_LENGTH_LOW:
+				_rxLength |= data;
+				_rxPosition = 0;
+				_rxChecksum = 0xFF;
+
+				// Frames not fitting into the buffer are skipped until the next delimiter.
+				if (_rxLength == 0 || _rxLength > XBEE_RX_BUFFER_SIZE)
+					_rxState = XBEE_RX_STATE_WAITING_FOR_DELIMITER;
+				else
+					_rxState = XBEE_RX_STATE_DATA;
+				break;
+
+			case XBEE_RX_STATE_DATA:
+				_rxBuffer[_rxPosition++] = data;
+				_rxChecksum -= data;
+
+				if (_rxPosition == _rxLength)
+					_rxState = XBEE_RX_STATE_CHECKSUM;
+				break;
+
+			case XBEE_RX_STATE_CHECKSUM:
+				if (data == _rxChecksum)
+					processFrame(_rxLength, _rxBuffer);
+
+				_rxState = XBEE_RX_STATE_WAITING_FOR_DELIMITER;
+				break;
+		}
+	}
+
+	if (_sleepScheduler != NULL)
+		_sleepScheduler -> update();
+}
+
+void XBeeBase::processFrame(int length, byte* frame)
+{
+	switch (frame[0])
+	{
+		case XBEE_API_MODEM_STATUS:
+			if (_sleepScheduler != NULL && length > 1)
+				_sleepScheduler -> handleModemStatus(frame[1]);
+			break;
+
+		case XBEE_API_TX_STATUS:
+			// frame ID, delivery status
+			if (_linkAdapter != NULL && length > 2)
+				_linkAdapter -> handleTxStatus(frame[2]);
+			break;
+
+		case XBEE_API_ZB_TX_STATUS:
+			// frame ID, 16-bit destination address, retry count, delivery status, discovery status
+			if (_linkAdapter != NULL && length > 5)
+				_linkAdapter -> handleTxStatus(frame[5], frame[4]);
+			break;
+
+		case XBEE_API_AT_COMMAND_RESPONSE:
+			// frame ID, command (2 bytes), command status, value
+			if (_linkAdapter != NULL && length > 4)
+				_linkAdapter -> handleATCommandResponse(frame[1], (frame[2] << 8) | frame[3], frame[4], length - 5, frame + 5);
+			break;
+	}
+}
+
+byte XBeeBase::sendATCommand(int command, int length, byte* value)
+{
+	byte frameId = nextFrameId();
+
+	writeHeader(length + XBEE_API_AT_COMMAND_HEADER_LENGTH);
+
+	writeDataByte(XBEE_API_AT_COMMAND);
+	writeDataByte(frameId);
+	writeDataInt(command);
+
+	writeData(length, value);
+
+	if (!writeChecksum())
+		return XBEE_DUMMY_FRAME_ID;
+
+	return frameId;
 }
 
 void XBeeBase::writeHeader(int length)
 {
-	writeByte(XBEE_FRAME_DELIMITER);
+	if (_sleepScheduler != NULL)
+		_sleepScheduler -> beginFrame();
+
+	// Frame delimiter is never escaped.
+	writeRawByte(XBEE_FRAME_DELIMITER);
 	
 	writeDataInt(length);
 	
@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 
+#include "XBeeSleepScheduler.h"
+#include "XBeeLinkAdapter.h"
+
 //#include <HardwareSerial.h>
 
 #define XBEE_FRAME_DELIMITER 0x7E
@@ -26,8 +29,22 @@
 #define XBEE_API_AT_COMMAND_RESPONSE 0x88
 #define XBEE_API_TX_STATUS 0x89
 #define XBEE_API_MODEM_STATUS 0x8A
+#define XBEE_API_ZB_TX_STATUS 0x8B
 #define XBEE_API_RX_IPV4 0xB0
 
+#define XBEE_API_AT_COMMAND_HEADER_LENGTH 0x0004
+
+#define XBEE_AT_COMMAND_STATUS_OK 0x00
+
+// Size of buffer for incoming API frames. Longer frames are ignored.
+#define XBEE_RX_BUFFER_SIZE 128
+
+#define XBEE_RX_STATE_WAITING_FOR_DELIMITER 0
+#define XBEE_RX_STATE_LENGTH_HIGH           1
+#define XBEE_RX_STATE_LENGTH_LOW            2
+#define XBEE_RX_STATE_DATA                  3
+#define XBEE_RX_STATE_CHECKSUM              4
+
 /**
  * Base class for all XBee devices supporting API mode. It provides ability to send and receive raw data
  * and limited support for reading and writing API frames. Currently it is used as a base class for
@@ -48,15 +65,97 @@ class XBeeBase
 		 */
 		XBeeBase(Stream* controlPort);
 
-		
+		/**
+		 * Reads all available data from the control stream and processes every complete API frame
+		 * received. Must be called regularly (i.e. from loop()).
+		 */
 		void readData();
+
+		/**
+		 * Attaches the sleep scheduler. When attached, frames sent while the module sleeps are
+		 * queued and sent when it wakes up.
+		 *
+		 * @param scheduler Pointer to the scheduler using the same control stream as this device,
+		 * or NULL to send all frames immediately.
+		 */
+		void setSleepScheduler(XBeeSleepScheduler* scheduler)
+		{
+			_sleepScheduler = scheduler;
+		}
+
+		/**
+		 * Attaches the link adapter. When attached, it receives the results of TX status frames and
+		 * ATDB responses, and adjusts bit rate and power level of the module.
+		 *
+		 * @param adapter Pointer to the adapter created for this device, or NULL to detach it.
+		 */
+		void setLinkAdapter(XBeeLinkAdapter* adapter)
+		{
+			_linkAdapter = adapter;
+		}
+
+		/**
+		 * Sends AT command to the local module (API frame 0x08). Changes are applied immediately.
+		 * The response is reported with AT command response frame.
+		 *
+		 * @param command Two-character command code (XBEE_AT*, i.e. XBEE_ATPL).
+		 * @param length Length of parameter value, or 0 to query current value.
+		 * @param value Byte buffer containing parameter value, big-endian.
+		 *
+		 * @return Frame ID of sent frame, or XBEE_DUMMY_FRAME_ID if the frame was dropped by
+		 * the sleep scheduler.
+		 */
+		byte sendATCommand(int command, int length, byte* value);
 		
 	protected:
 		Stream* _controlPort;
+
+		XBeeSleepScheduler* _sleepScheduler;
+
+		XBeeLinkAdapter* _linkAdapter;
+
+		byte _frameId;
 		
 		boolean _escapementRequired;
 		
 		byte _checksum;
+
+		byte _rxBuffer[XBEE_RX_BUFFER_SIZE];
+
+		byte _rxState;
+
+		boolean _rxUnescapeNext;
+
+		int _rxLength;
+
+		int _rxPosition;
+
+		byte _rxChecksum;
+
+		/**
+		 * Processes a complete API frame with valid checksum. Derived classes may override it
+		 * to handle device-specific frames, but must call the base implementation.
+		 *
+		 * @param length Length of frame data (API identifier included).
+		 * @param frame Frame data, starting from API identifier.
+		 */
+		virtual void processFrame(int length, byte* frame);
+
+		/**
+		 * Generates the frame ID for the next frame requiring response. Never returns
+		 * XBEE_DUMMY_FRAME_ID, since it disables the response.
+		 *
+		 * @return Frame ID to use.
+		 */
+		byte nextFrameId()
+		{
+			_frameId++;
+
+			if (_frameId == XBEE_DUMMY_FRAME_ID)
+				_frameId++;
+
+			return _frameId;
+		}
 		
 		/**
 		 * Resets the checksum. Must be called before the transmission starts
@@ -77,11 +176,19 @@ class XBeeBase
 		}
 		
 		/**
-		 * Sends the checksum to the module.
+		 * Sends the checksum to the module. Must be the last byte of each API frame.
+		 *
+		 * @return true if the frame was sent or queued, false if it was dropped by the sleep
+		 * scheduler because its queue is full.
 		 */
-		void writeChecksum()
+		boolean writeChecksum()
 		{
 			writeByte(_checksum);
+
+			if (_sleepScheduler != NULL)
+				return _sleepScheduler -> endFrame();
+
+			return true;
 		}
 		
 
@@ -90,12 +197,16 @@ class XBeeBase
 		 * Writes raw byte of data - just sends it to the control stream as-is. This method
 		 * must be used when sent byte must not be escaped - i.e. for frame delimiter (first byte
 		 * of the API frame) and for data when escapement is disabled in settings (AP = 1).
+		 * If the module sleeps, byte is queued by the sleep scheduler instead.
 		 *
 		 * @param data Byte of data to send.
 		 */
 		void writeRawByte(byte data)
 		{
-			_controlPort -> write(data);
+			if (_sleepScheduler != NULL && _sleepScheduler -> isQueueing())
+				_sleepScheduler -> queueByte(data);
+			else
+				_controlPort -> write(data);
 		}
 		
 		/**
@@ -129,7 +240,7 @@ class XBeeBase
 			if (_escapementRequired)
 				writeEscapedByte(data);
 			else
-				writeByte(data);
+				writeRawByte(data);
 		}
 
 		/**
@@ -146,6 +257,18 @@ class XBeeBase
 			addByteToChecksum(data);
 		}
 		
+		/**
+		 * Writes buffer of data and adds it to checksum.
+		 *
+		 * @param length Length of buffer.
+		 * @param data Buffer containing data to send.
+		 */
+		void writeData(int length, byte* data)
+		{
+			for (int i = 0; i < length; i++)
+				writeDataByte(data[i]);
+		}
+
 		/**
 		 * Writes 16-bit integer in big-endian style (as required by XBee modules). May be used to write 
 		 * length of frame or any 16-bit frame-specific data.
@@ -182,7 +305,8 @@ class XBeeBase
 		
 		
 		/**
-		 * Writes API frame header (frame delimiter and frame length).
+		 * Writes API frame header (frame delimiter and frame length). Every frame must be
+		 * started with this method and finished with writeChecksum().
 		 *
 		 * @param length Length of frame that will follow this header.
 		 */
@@ -0,0 +1,317 @@
+#include "XBeeLinkAdapter.h"
+#include "XBeeBase.h"
+#include "../XBeeATCommands.h"
+
+// Legacy bit rates ordered by speed (ATBR values are not).
+static const byte XBEE_LINK_RATES[] =
+{
+	XBEE_ATBR_1MBPS, XBEE_ATBR_2MBPS, XBEE_ATBR_5_5MBPS, XBEE_ATBR_6MBPS,
+	XBEE_ATBR_9MBPS, XBEE_ATBR_11MBPS, XBEE_ATBR_12MBPS, XBEE_ATBR_18MBPS,
+	XBEE_ATBR_24MBPS, XBEE_ATBR_36MBPS, XBEE_ATBR_48MBPS, XBEE_ATBR_54MBPS
+};
+
+#define XBEE_LINK_RATE_COUNT (sizeof(XBEE_LINK_RATES) / sizeof(XBEE_LINK_RATES[0]))
+
+XBeeLinkAdapter::XBeeLinkAdapter(XBeeBase* xbee)
+{
+	_xbee = xbee;
+	_targetPercent = 90;
+	_hysteresisPercent = 5;
+	_strongRssi = 50;
+	_minRateIndex = 0;
+	_maxRateIndex = XBEE_LINK_RATE_COUNT - 1;
+	_rateIndex = _minRateIndex;
+	_previousRateIndex = _rateIndex;
+	_minPowerLevel = XBEE_ATPL_LOWEST;
+	_maxPowerLevel = XBEE_ATPL_HIGHEST;
+	_powerLevel = _maxPowerLevel;
+	_previousPowerLevel = _powerLevel;
+	_rssi = XBEE_LINK_RSSI_UNKNOWN;
+	_window = XBEE_LINK_DEFAULT_WINDOW;
+	_frames = 0;
+	_delivered = 0;
+	_retries = 0;
+	_goodWindows = 0;
+	_badWindows = 0;
+	_stepUpWindows = XBEE_LINK_STEP_UP_WINDOWS;
+	_lastStepUp = XBEE_LINK_STEP_NONE;
+	_rateFrameId = XBEE_DUMMY_FRAME_ID;
+	_powerFrameId = XBEE_DUMMY_FRAME_ID;
+}
+
+void XBeeLinkAdapter::begin()
+{
+	_rateIndex = _minRateIndex;
+	_previousRateIndex = _rateIndex;
+	_powerLevel = _maxPowerLevel;
+	_previousPowerLevel = _powerLevel;
+
+	if (_xbee != NULL)
+	{
+		byte bitRate = XBEE_LINK_RATES[_rateIndex];
+		_rateFrameId = _xbee -> sendATCommand(XBEE_ATBR, 1, &bitRate);
+		_powerFrameId = _xbee -> sendATCommand(XBEE_ATPL, 1, &_powerLevel);
+	}
+}
+
+void XBeeLinkAdapter::setTargetDeliveryRate(byte targetPercent, byte hysteresisPercent)
+{
+	_targetPercent = min(targetPercent, 100);
+	_hysteresisPercent = min(hysteresisPercent, min(_targetPercent, 100 - _targetPercent));
+}
+
+void XBeeLinkAdapter::setWindow(int frames)
+{
+	_window = max(frames, 1);
+}
+
+void XBeeLinkAdapter::setStrongRssi(byte strong)
+{
+	_strongRssi = strong;
+}
+
+void XBeeLinkAdapter::setBitRateRange(byte minBitRate, byte maxBitRate)
+{
+	int minIndex = findRateIndex(minBitRate);
+	int maxIndex = findRateIndex(maxBitRate);
+
+	if (minIndex < 0 || maxIndex < 0 || minIndex > maxIndex)
+		return;
+
+	_minRateIndex = minIndex;
+	_maxRateIndex = maxIndex;
+	_rateIndex = constrain(_rateIndex, _minRateIndex, _maxRateIndex);
+}
+
+void XBeeLinkAdapter::setPowerLevelRange(byte minPowerLevel, byte maxPowerLevel)
+{
+	if (minPowerLevel > maxPowerLevel || maxPowerLevel > XBEE_ATPL_HIGHEST)
+		return;
+
+	_minPowerLevel = minPowerLevel;
+	_maxPowerLevel = maxPowerLevel;
+	_powerLevel = constrain(_powerLevel, _minPowerLevel, _maxPowerLevel);
+}
+
+void XBeeLinkAdapter::handleTxStatus(byte status, byte retries)
+{
+	_frames++;
+	_retries += retries;
+
+	if (status == XBEE_TX_STATUS_SUCCESS)
+		_delivered++;
+
+	if (_frames >= _window)
+		evaluateWindow();
+}
+
+void XBeeLinkAdapter::handleATCommandResponse(byte frameId, int command, byte status, int length, byte* value)
+{
+	if (status == XBEE_AT_COMMAND_STATUS_OK && command == XBEE_ATDB && length > 0)
+		handleRssi(value[length - 1]);
+
+	// Only responses to the last ATBR / ATPL sent by the adapter are tracked - the application
+	// may send the same commands itself. No response comes with XBEE_DUMMY_FRAME_ID, so dropped
+	// requests never match.
+	boolean rateResponse = (command == XBEE_ATBR && frameId == _rateFrameId);
+	boolean powerResponse = (command == XBEE_ATPL && frameId == _powerFrameId);
+
+	if (rateResponse)
+		_rateFrameId = XBEE_DUMMY_FRAME_ID;
+
+	if (powerResponse)
+		_powerFrameId = XBEE_DUMMY_FRAME_ID;
+
+	if (status == XBEE_AT_COMMAND_STATUS_OK)
+	{
+		// Value is returned only when reading the setting back after it was rejected.
+		if (rateResponse && length > 0)
+		{
+			int rateIndex = findRateIndex(value[length - 1]);
+
+			if (rateIndex >= 0)
+			{
+				_rateIndex = rateIndex;
+				_minRateIndex = _rateIndex;
+				_maxRateIndex = _rateIndex;
+			}
+		}
+		else if (powerResponse && length > 0 && value[length - 1] <= XBEE_ATPL_HIGHEST)
+		{
+			_powerLevel = value[length - 1];
+			_minPowerLevel = _powerLevel;
+			_maxPowerLevel = _powerLevel;
+		}
+
+		return;
+	}
+
+	// Rejected setting is rolled back and excluded from adaptation, otherwise the adapter would
+	// keep "changing" the value the module does not accept. The module keeps its own value, which
+	// is not always the previous one (i.e. when begin() is rejected), so it is read back.
+	if (rateResponse)
+	{
+		_rateIndex = _previousRateIndex;
+		_minRateIndex = _rateIndex;
+		_maxRateIndex = _rateIndex;
+
+		if (_lastStepUp == XBEE_LINK_STEP_RATE)
+			_lastStepUp = XBEE_LINK_STEP_NONE;
+
+		if (_xbee != NULL)
+			_rateFrameId = _xbee -> sendATCommand(XBEE_ATBR, 0, NULL);
+	}
+	else if (powerResponse)
+	{
+		_powerLevel = _previousPowerLevel;
+		_minPowerLevel = _powerLevel;
+		_maxPowerLevel = _powerLevel;
+
+		if (_lastStepUp == XBEE_LINK_STEP_POWER)
+			_lastStepUp = XBEE_LINK_STEP_NONE;
+
+		if (_xbee != NULL)
+			_powerFrameId = _xbee -> sendATCommand(XBEE_ATPL, 0, NULL);
+	}
+}
+
+void XBeeLinkAdapter::handleRssi(byte rssi)
+{
+	// Exponential moving average with weight 1/4 smooths out single fades.
+	if (_rssi == XBEE_LINK_RSSI_UNKNOWN)
+		_rssi = rssi;
+	else
+		_rssi = (3 * _rssi + rssi) / 4;
+}
+
+byte XBeeLinkAdapter::getBitRate()
+{
+	return XBEE_LINK_RATES[_rateIndex];
+}
+
+void XBeeLinkAdapter::evaluateWindow()
+{
+	int deliveryPercent = _delivered * 100L / _frames;
+	int retriesPerFrame4 = _retries * 4L / _frames; // average retries per frame, x0.25
+
+	// Larger RSSI value means weaker signal (it is measured in -dBm).
+	boolean rssiKnown = (_rssi != XBEE_LINK_RSSI_UNKNOWN);
+	boolean strongSignal = rssiKnown && _rssi < _strongRssi;
+
+	byte rateIndex = _rateIndex;
+	byte powerLevel = _powerLevel;
+
+	if (deliveryPercent < _targetPercent - _hysteresisPercent)
+	{
+		_goodWindows = 0;
+		_badWindows++;
+
+		if (_lastStepUp != XBEE_LINK_STEP_NONE)
+		{
+			// The last step up was not confirmed - undo it and make the next one less frequent.
+			_stepUpWindows = min(_stepUpWindows * 2, XBEE_LINK_MAX_STEP_UP_WINDOWS);
+
+			if (_lastStepUp == XBEE_LINK_STEP_RATE && rateIndex > _minRateIndex)
+				rateIndex--;
+			else if (_lastStepUp == XBEE_LINK_STEP_POWER && powerLevel < _maxPowerLevel)
+				powerLevel++;
+
+			_lastStepUp = XBEE_LINK_STEP_NONE;
+			_badWindows = 0;
+		}
+		else if (_badWindows >= XBEE_LINK_STEP_DOWN_WINDOWS)
+		{
+			// Link got worse at the settings it used to keep, so the way back up must be slower too.
+			_stepUpWindows = min(_stepUpWindows * 2, XBEE_LINK_MAX_STEP_UP_WINDOWS);
+
+			if (powerLevel < _maxPowerLevel)
+				powerLevel++;
+			else if (rateIndex > _minRateIndex)
+				rateIndex--;
+
+			_badWindows = 0;
+		}
+	}
+	else if (deliveryPercent >= _targetPercent + _hysteresisPercent && retriesPerFrame4 < 4)
+	{
+		_badWindows = 0;
+
+		// Good window confirms the last step up, so the next one may be tried sooner. Back-off
+		// is only halved: climbing back to settings that worked before says little about the
+		// next step, which may be the one that failed.
+		if (_lastStepUp != XBEE_LINK_STEP_NONE)
+		{
+			_stepUpWindows = max(_stepUpWindows / 2, XBEE_LINK_STEP_UP_WINDOWS);
+			_lastStepUp = XBEE_LINK_STEP_NONE;
+		}
+
+		_goodWindows++;
+
+		if (_goodWindows >= _stepUpWindows)
+		{
+			_goodWindows = 0;
+
+			if (rateIndex < _maxRateIndex)
+			{
+				rateIndex++;
+				_lastStepUp = XBEE_LINK_STEP_RATE;
+			}
+			else if (strongSignal && powerLevel > _minPowerLevel)
+			{
+				powerLevel--;
+				_lastStepUp = XBEE_LINK_STEP_POWER;
+			}
+		}
+	}
+	else
+	{
+		// Within the dead band - keep the settings and leave the last step up unconfirmed.
+		_goodWindows = 0;
+		_badWindows = 0;
+	}
+
+	applySettings(rateIndex, powerLevel);
+
+	_frames = 0;
+	_delivered = 0;
+	_retries = 0;
+
+	// Request fresh RSSI sample for the next window.
+	if (_xbee != NULL)
+		_xbee -> sendATCommand(XBEE_ATDB, 0, NULL);
+}
+
+void XBeeLinkAdapter::applySettings(byte rateIndex, byte powerLevel)
+{
+	if (rateIndex != _rateIndex)
+	{
+		_previousRateIndex = _rateIndex;
+		_rateIndex = rateIndex;
+
+		if (_xbee != NULL)
+		{
+			byte bitRate = XBEE_LINK_RATES[_rateIndex];
+			_rateFrameId = _xbee -> sendATCommand(XBEE_ATBR, 1, &bitRate);
+		}
+	}
+
+	if (powerLevel != _powerLevel)
+	{
+		_previousPowerLevel = _powerLevel;
+		_powerLevel = powerLevel;
+
+		if (_xbee != NULL)
+			_powerFrameId = _xbee -> sendATCommand(XBEE_ATPL, 1, &_powerLevel);
+	}
+}
+
+int XBeeLinkAdapter::findRateIndex(byte bitRate)
+{
+	for (byte i = 0; i < XBEE_LINK_RATE_COUNT; i++)
+	{
+		if (XBEE_LINK_RATES[i] == bitRate)
+			return i;
+	}
+
+	return -1;
+}
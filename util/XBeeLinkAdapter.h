@@ -0,0 +1,233 @@
+#ifndef XBEE_LINK_ADAPTER_H
+#define XBEE_LINK_ADAPTER_H
+
+#include <Arduino.h>
+
+#define XBEE_TX_STATUS_SUCCESS 0x00
+
+// Default number of TX status results collected before each adaptation decision (see setWindow()).
+#define XBEE_LINK_DEFAULT_WINDOW 20
+
+// Number of good windows in a row required to step up: doubled after every step down, halved after every confirmed step up.
+#define XBEE_LINK_STEP_UP_WINDOWS     2
+#define XBEE_LINK_MAX_STEP_UP_WINDOWS 16
+
+// Number of bad windows in a row required to step down (an unconfirmed step up is undone after one).
+#define XBEE_LINK_STEP_DOWN_WINDOWS 2
+
+#define XBEE_LINK_STEP_NONE  0
+#define XBEE_LINK_STEP_RATE  1
+#define XBEE_LINK_STEP_POWER 2
+
+#define XBEE_LINK_RSSI_UNKNOWN 0
+
+class XBeeBase;
+
+/**
+ * Adaptive bit rate (ATBR) and power level (ATPL) controller. It collects delivery results from
+ * TX status frames and RSSI samples (ATDB) and, once per window of frames (see setWindow()), decides
+ * whether the link must be made more robust or may be made faster / cheaper:
+ *
+ * - if delivery rate stays below (target - hysteresis) for two windows in a row, power level is
+ *   increased, or bit rate is decreased when power level is already maximal (power costs energy,
+ *   but not goodput);
+ * - if delivery rate stays at or above (target + hysteresis) with few retries for several windows
+ *   in a row, bit rate is increased, or power level is decreased when bit rate is already maximal
+ *   and the signal is strong.
+ *
+ * A step up stays unconfirmed until a good window follows it; windows in the dead band do not
+ * confirm it. If a bad window comes first, the step up is undone (the same knob is moved back).
+ * Every step down (undone step up included) doubles the number of good windows required for the
+ * next step up, and only a confirmed step up halves it back. So the controller does not keep
+ * switching between two neighbour settings, and a failed power-down is undone even if it did not
+ * change RSSI (ATDB measures the signal of the peer, which does not depend on our power level).
+ *
+ * Bit rate can only be set on XBee S6 modules acting as IBSS creator (ATAH = 0); use
+ * setBitRateRange() with equal bounds to adapt only the power level on other links. If the module
+ * rejects ATBR or ATPL, the adapter stops changing the setting: it reads the value back from the
+ * module and narrows the range to it, so it keeps in sync with the module (a bit rate outside of
+ * the legacy rates is not adopted - the adapter then keeps its previous one).
+ *
+ * Adapter is attached to the XBee device with XBeeBase::setLinkAdapter(). It can also be used
+ * without a device (pass NULL to the constructor) - then it only tracks the chosen settings.
+ */
+class XBeeLinkAdapter
+{
+	public:
+		/**
+		 * Constructor. Adapter starts from the lowest bit rate and the highest power level and
+		 * targets 90% delivery rate with 5% hysteresis.
+		 *
+		 * @param xbee Device used to apply the settings and to request RSSI samples, or NULL.
+		 */
+		XBeeLinkAdapter(XBeeBase* xbee);
+
+		/**
+		 * Sends initial bit rate and power level to the module. Must be called after all
+		 * settings of the adapter are made.
+		 */
+		void begin();
+
+		/**
+		 * Sets the delivery rate the adapter must keep. Adapter steps down when less than
+		 * (target - hysteresis) % of frames in the window are delivered, and counts the window as
+		 * good when at least (target + hysteresis) % are delivered. The thresholds are applied to
+		 * whole frames: with the defaults (90%, 5%, window of 20 frames) it steps down at 16 of 20
+		 * delivered frames or less, and needs 19 of 20 for a good window. Keep the window large
+		 * enough for the dead band to contain at least one frame.
+		 *
+		 * Values are clamped so that both thresholds stay within 0..100%.
+		 *
+		 * @param targetPercent Target delivery rate, % (at most 100).
+		 * @param hysteresisPercent Half-width of dead band around the target, % (at most
+		 * targetPercent and 100 - targetPercent).
+		 */
+		void setTargetDeliveryRate(byte targetPercent, byte hysteresisPercent);
+
+		/**
+		 * Sets the number of TX status results collected before each adaptation decision.
+		 * Larger window reacts slower, but measures delivery rate more precisely.
+		 *
+		 * @param frames Window size, frames (at least 1).
+		 */
+		void setWindow(int frames);
+
+		/**
+		 * Sets RSSI limit allowing the adapter to decrease power level at maximal bit rate.
+		 *
+		 * @param strong Signal stronger than -strong dBm is considered strong (i.e. 50 for -50 dBm).
+		 */
+		void setStrongRssi(byte strong);
+
+		/**
+		 * Limits bit rates used by the adapter. Bounds must be legacy (non-MCS) rates.
+		 *
+		 * @param minBitRate Lowest bit rate (XBEE_ATBR_*).
+		 * @param maxBitRate Highest bit rate (XBEE_ATBR_*).
+		 */
+		void setBitRateRange(byte minBitRate, byte maxBitRate);
+
+		/**
+		 * Limits power levels used by the adapter.
+		 *
+		 * @param minPowerLevel Lowest power level (XBEE_ATPL_*).
+		 * @param maxPowerLevel Highest power level (XBEE_ATPL_*).
+		 */
+		void setPowerLevelRange(byte minPowerLevel, byte maxPowerLevel);
+
+		/**
+		 * Adds delivery result of one frame. Called by XBeeBase::readData() for every TX status frame
+		 * (0x89, XBee S6) and ZigBee transmit status frame (0x8B, XBee S2).
+		 *
+		 * @param status Delivery status (XBEE_TX_STATUS_SUCCESS or error code).
+		 * @param retries Number of retries made to deliver the frame. Only XBee S2 reports it;
+		 * frames from XBee S6 are counted as sent without retries.
+		 */
+		void handleTxStatus(byte status, byte retries = 0);
+
+		/**
+		 * Handles the response to AT command. Called by XBeeBase::readData() for every AT command
+		 * response frame. Errors roll back the setting only for ATBR / ATPL requests sent by the
+		 * adapter itself (matched by frame ID); RSSI is taken from any successful ATDB response.
+		 *
+		 * @param frameId Frame ID of the AT command the response belongs to.
+		 * @param command Two-character command code (XBEE_AT*).
+		 * @param status Command status (XBEE_AT_COMMAND_STATUS_OK or error code).
+		 * @param length Length of returned value.
+		 * @param value Returned value, big-endian.
+		 */
+		void handleATCommandResponse(byte frameId, int command, byte status, int length, byte* value);
+
+		/**
+		 * Adds RSSI sample. Called by handleATCommandResponse() for every successful ATDB response.
+		 *
+		 * @param rssi Signal strength of the last received packet, -dBm.
+		 */
+		void handleRssi(byte rssi);
+
+		/**
+		 * @return Current bit rate (XBEE_ATBR_*).
+		 */
+		byte getBitRate();
+
+		/**
+		 * @return Current power level (XBEE_ATPL_*).
+		 */
+		byte getPowerLevel()
+		{
+			return _powerLevel;
+		}
+
+		/**
+		 * @return Averaged RSSI, -dBm, or XBEE_LINK_RSSI_UNKNOWN if no samples received yet.
+		 */
+		byte getRssi()
+		{
+			return _rssi;
+		}
+
+	private:
+		XBeeBase* _xbee;
+
+		byte _targetPercent;
+
+		byte _hysteresisPercent;
+
+		byte _strongRssi;
+
+		byte _minRateIndex;
+
+		byte _maxRateIndex;
+
+		byte _rateIndex;
+
+		byte _previousRateIndex;
+
+		byte _minPowerLevel;
+
+		byte _maxPowerLevel;
+
+		byte _powerLevel;
+
+		byte _previousPowerLevel;
+
+		byte _rssi;
+
+		int _window;
+
+		int _frames;
+
+		int _delivered;
+
+		long _retries;
+
+		byte _goodWindows;
+
+		byte _badWindows;
+
+		byte _stepUpWindows;
+
+		byte _lastStepUp;
+
+		byte _rateFrameId;
+
+		byte _powerFrameId;
+
+		/**
+		 * Makes the adaptation decision for the finished window and starts the new one.
+		 */
+		void evaluateWindow();
+
+		/**
+		 * Changes bit rate and/or power level and sends changed values to the module.
+		 */
+		void applySettings(byte rateIndex, byte powerLevel);
+
+		/**
+		 * @return Index of the bit rate in the table of rates ordered by speed, or -1 if
+		 * bit rate is not in the table.
+		 */
+		static int findRateIndex(byte bitRate);
+};
+
+#endif
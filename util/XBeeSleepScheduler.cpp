@@ -0,0 +1,111 @@
+#include "XBeeSleepScheduler.h"
+
+XBeeSleepScheduler::XBeeSleepScheduler(Stream* controlPort, byte* queue, int queueSize)
+{
+	_controlPort = controlPort;
+	_queue = queue;
+	_queueSize = queueSize;
+	_awake = true;
+	_onSleepPin = XBEE_SLEEP_PIN_NONE;
+	_queueLength = 0;
+	_queuedFrames = 0;
+	_droppedFrames = 0;
+	_queueing = false;
+	_frameOverflow = false;
+	_frameStart = 0;
+}
+
+void XBeeSleepScheduler::setOnSleepPin(int pin)
+{
+	_onSleepPin = pin;
+
+	if (_onSleepPin != XBEE_SLEEP_PIN_NONE)
+		pinMode(_onSleepPin, INPUT);
+}
+
+void XBeeSleepScheduler::handleModemStatus(byte status)
+{
+	switch (status)
+	{
+		case XBEE_MODEM_STATUS_NETWORK_WENT_TO_SLEEP:
+			_awake = false;
+			break;
+
+		case XBEE_MODEM_STATUS_NETWORK_WOKE_UP:
+		case XBEE_MODEM_STATUS_HARDWARE_RESET:
+		case XBEE_MODEM_STATUS_WATCHDOG_RESET:
+			_awake = true;
+			break;
+	}
+}
+
+boolean XBeeSleepScheduler::pollAwake()
+{
+	if (_onSleepPin != XBEE_SLEEP_PIN_NONE)
+		_awake = (digitalRead(_onSleepPin) == HIGH);
+
+	return _awake;
+}
+
+void XBeeSleepScheduler::update()
+{
+	// Never flush in the middle of queued frame - it will be sent with the rest of the queue.
+	if (pollAwake() && !_queueing)
+		flush();
+}
+
+void XBeeSleepScheduler::flush()
+{
+	if (_queueLength > 0)
+		_controlPort -> write(_queue, _queueLength);
+
+	_queueLength = 0;
+	_queuedFrames = 0;
+}
+
+void XBeeSleepScheduler::beginFrame()
+{
+	// State is read once, since ON_SLEEP interrupt may change it at any moment. Queued frames
+	// must go first to keep the order of frames.
+	boolean awake = pollAwake();
+
+	if (awake)
+		flush();
+
+	_queueing = !awake;
+	_frameOverflow = false;
+	_frameStart = _queueLength;
+}
+
+boolean XBeeSleepScheduler::endFrame()
+{
+	if (!_queueing)
+		return true;
+
+	_queueing = false;
+
+	if (_frameOverflow)
+	{
+		// Roll back the partially queued frame.
+		_queueLength = _frameStart;
+		_droppedFrames++;
+		return false;
+	}
+
+	_queuedFrames++;
+	return true;
+}
+
+void XBeeSleepScheduler::queueByte(byte data)
+{
+	if (_frameOverflow)
+		return;
+
+	if (_queueLength >= _queueSize)
+	{
+		_frameOverflow = true;
+		return;
+	}
+
+	_queue[_queueLength++] = data;
+}
@@ -0,0 +1,186 @@
+#ifndef XBEE_SLEEP_SCHEDULER_H
+#define XBEE_SLEEP_SCHEDULER_H
+
+#include <Arduino.h>
+
+#define XBEE_MODEM_STATUS_HARDWARE_RESET        0x00
+#define XBEE_MODEM_STATUS_WATCHDOG_RESET        0x01
+#define XBEE_MODEM_STATUS_NETWORK_WOKE_UP       0x0B // DigiMesh synchronous sleep only
+#define XBEE_MODEM_STATUS_NETWORK_WENT_TO_SLEEP 0x0C // DigiMesh synchronous sleep only
+
+#define XBEE_SLEEP_PIN_NONE -1
+
+class XBeeBase;
+
+/**
+ * Power-aware scheduler for outgoing API frames. It tracks whether the module is awake or
+ * sleeping (using ON_SLEEP pin and modem status frames) and buffers every frame sent
+ * while the module sleeps. Buffered frames are sent to the module as one burst as soon as
+ * it wakes up, so the host does not force additional wake-ups and does not lose frames
+ * sent into the sleeping module.
+ *
+ * Queue is a buffer provided by the caller and holds encoded API frames (TX64 request takes
+ * 15 bytes plus the data, more if escapement is enabled). Frames that do not fit into the queue
+ * are dropped (see getDroppedFrames()). Frames are never split - either the whole frame is queued
+ * or it is dropped.
+ *
+ * Neither XBee S2 (ZB firmware) nor XBee S6 reports its own sleep with modem status frames,
+ * so ON_SLEEP pin must be connected on both of them - either polled (see setOnSleepPin()) or
+ * handled by interrupt (see setAwake()). Without it the module is always considered awake.
+ *
+ * Scheduler is attached to the XBee device with XBeeBase::setSleepScheduler() and must use
+ * the same control stream as the device.
+ */
+class XBeeSleepScheduler
+{
+	friend class XBeeBase;
+
+	public:
+		/**
+		 * Constructor. Module is considered awake until the scheduler learns otherwise.
+		 *
+		 * @param controlPort Pointer to the stream used to control target XBee module. Must be
+		 * the same stream that is passed to the XBee device constructor.
+		 * @param queue Buffer used to store frames while the module sleeps. Must exist as long
+		 * as the scheduler does.
+		 * @param queueSize Size of the buffer, bytes.
+		 */
+		XBeeSleepScheduler(Stream* controlPort, byte* queue, int queueSize);
+
+		/**
+		 * Sets the pin connected to ON_SLEEP output of the module (pin 13; on XBee S6 it is DIO9
+		 * and requires ATD9 = 1). State of this pin is polled by update(). ON_SLEEP is high while
+		 * the module is awake.
+		 *
+		 * @param pin Number of Arduino pin connected to ON_SLEEP, or XBEE_SLEEP_PIN_NONE to
+		 * stop polling the pin.
+		 */
+		void setOnSleepPin(int pin);
+
+		/**
+		 * Sets the sleep state of the module. May be used as ON_SLEEP pin change callback
+		 * (i.e. from attachInterrupt() handler) - it only stores the state, queued frames are
+		 * sent by the next call to update().
+		 *
+		 * @param awake true if the module is awake now.
+		 */
+		void setAwake(boolean awake)
+		{
+			_awake = awake;
+		}
+
+		/**
+		 * Updates the sleep state of the module from the modem status frame. Reset of the module
+		 * means it is awake; network sleep and wake-up events are reported only by DigiMesh
+		 * modules using synchronous sleep, not by XBee S2 or S6. Called by XBeeBase::readData()
+		 * for every modem status frame.
+		 *
+		 * @param status Status byte of modem status frame (XBEE_MODEM_STATUS_*).
+		 */
+		void handleModemStatus(byte status);
+
+		/**
+		 * Polls the ON_SLEEP pin (if set) and sends queued frames if the module is awake.
+		 * Called by XBeeBase::readData(), so you need to call it only if you do not read data
+		 * from the module regularly.
+		 */
+		void update();
+
+		/**
+		 * Sends all queued frames to the module immediately, regardless of its sleep state.
+		 */
+		void flush();
+
+		/**
+		 * @return true if the module is considered awake.
+		 */
+		boolean isAwake()
+		{
+			return _awake;
+		}
+
+		/**
+		 * @return Number of frames waiting for the module to wake up.
+		 */
+		int getQueuedFrames()
+		{
+			return _queuedFrames;
+		}
+
+		/**
+		 * @return Number of bytes waiting for the module to wake up.
+		 */
+		int getQueuedBytes()
+		{
+			return _queueLength;
+		}
+
+		/**
+		 * @return Number of frames dropped because the queue was full.
+		 */
+		unsigned int getDroppedFrames()
+		{
+			return _droppedFrames;
+		}
+
+	private:
+		Stream* _controlPort;
+
+		volatile boolean _awake;
+
+		int _onSleepPin;
+
+		byte* _queue;
+
+		int _queueSize;
+
+		int _queueLength;
+
+		int _queuedFrames;
+
+		unsigned int _droppedFrames;
+
+		boolean _queueing;
+
+		boolean _frameOverflow;
+
+		int _frameStart;
+
+		/**
+		 * Polls the ON_SLEEP pin (if set) and takes a snapshot of the sleep state.
+		 *
+		 * @return true if the module is considered awake.
+		 */
+		boolean pollAwake();
+
+		/**
+		 * Starts the new outgoing frame. If the module is awake, queued frames are sent and
+		 * the new frame goes directly to the module; otherwise the new frame is queued.
+		 */
+		void beginFrame();
+
+		/**
+		 * Finishes the outgoing frame started by beginFrame(). Frame is dropped if it
+		 * did not fit into the queue.
+		 *
+		 * @return true if the frame was sent or queued, false if it was dropped.
+		 */
+		boolean endFrame();
+
+		/**
+		 * Appends raw (already escaped) byte of the current frame to the queue.
+		 *
+		 * @param data Byte of data to queue.
+		 */
+		void queueByte(byte data);
+
+		/**
+		 * @return true if bytes of the current frame must be queued instead of being sent.
+		 */
+		boolean isQueueing()
+		{
+			return _queueing;
+		}
+};
+
+#endif